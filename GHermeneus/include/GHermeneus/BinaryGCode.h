@@ -0,0 +1,142 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#ifndef GCODEHERMENEUS_BINARYGCODE_H
+#define GCODEHERMENEUS_BINARYGCODE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include "Header.h"
+
+namespace GHermeneus
+{
+/*!
+ * @brief The types of blocks in a binary GCode file
+ */
+enum class BlockType : uint16_t
+{
+    FileMetadata = 0,
+    GCode = 1,
+    SlicerMetadata = 2,
+    PrinterMetadata = 3,
+    PrintMetadata = 4,
+    Thumbnail = 5
+};
+
+/*!
+ * @brief The compression of the data in a binary GCode block
+ */
+enum class BlockCompression : uint16_t
+{
+    None = 0,
+    Deflate = 1,
+    Heatshrink11_4 = 2,
+    Heatshrink12_4 = 3
+};
+
+/*!
+ * @brief The encoding of the data in a binary GCode block
+ */
+enum class BlockEncoding : uint16_t
+{
+    None = 0,            //!< Plain text, INI formatted for metadata blocks
+    MeatPack = 1,        //!< MeatPack packed GCode, with the comments stripped
+    MeatPackComments = 2 //!< MeatPack packed GCode, with the comments kept
+};
+
+/*!
+ * @brief Check if a file is a binary GCode file by looking at its magic bytes
+ * @param path the path to the file
+ * @return true if the file starts with the binary GCode magic bytes
+ */
+[[nodiscard]] bool isBinaryGCode(const std::filesystem::path& path);
+
+/*!
+ * A binary GCode file consists of a file header followed by metadata blocks, thumbnails and finally the GCode blocks.
+ * The metadata blocks are read by header() without touching the GCode blocks. The GCode blocks are decoded one by one
+ * with next(), these can be fed to a Machine:
+ *
+ *      auto UM3 = MarlinMachine();
+ *      BinaryGCodeReader gcode_file("big.bgcode");
+ *      auto meta = gcode_file.header(); // Only reads the metadata blocks
+ *      UM3 << gcode_file;               // Decodes and parses the GCode blocks
+ *
+ * @brief Reads the metadata and the GCode blocks of a binary GCode file
+ */
+class BinaryGCodeReader
+{
+  public:
+    /*!
+     * @brief Opens the file and validates the file header
+     * @param path the path to the binary GCode file
+     */
+    explicit BinaryGCodeReader(const std::filesystem::path& path);
+
+    /*!
+     * @brief The metadata of the file, the metadata blocks are read on the first call
+     * @return the Header containing the key/value pairs of all metadata blocks or std::nullopt if the file doesn't
+     * contain metadata blocks
+     */
+    [[nodiscard]] const std::optional<Header>& header();
+
+    /*!
+     * @brief Decode the next GCode block
+     * @return the GCode of the block ending on a line boundary or std::nullopt when all blocks are read
+     */
+    [[nodiscard]] std::optional<std::string> next();
+
+  private:
+    /*!
+     * @brief The header preceding the parameters and data of each block
+     */
+    struct BlockHeader
+    {
+        BlockType type;
+        BlockCompression compression;
+        uint32_t uncompressed_size;
+        uint32_t compressed_size;
+    };
+
+    /*!
+     * @brief Read the header of the block at the current position
+     * @return the BlockHeader or std::nullopt at the end of the file
+     */
+    [[nodiscard]] std::optional<BlockHeader> readBlockHeader();
+
+    /*!
+     * @brief Read the parameters and data of the block, verify its checksum and decompress and decode the data
+     * @param block_header the previously read header of the block
+     * @return the decoded data of the block
+     */
+    [[nodiscard]] std::string readBlock(const BlockHeader& block_header);
+
+    /*!
+     * @brief Skip the parameters, data and checksum of the block
+     * @param block_header the previously read header of the block
+     */
+    void skipBlock(const BlockHeader& block_header);
+
+    /*!
+     * @brief Add the INI formatted key/value pairs of a metadata block to the Header
+     * @param type the type of metadata block
+     * @param ini the decoded data of the metadata block
+     */
+    void addMetadata(BlockType type, const std::string_view& ini);
+
+    std::ifstream file;                    //!< The binary GCode file
+    uintmax_t file_size{ 0 };              //!< The size of the binary GCode file in bytes
+    uint16_t checksum_type{ 0 };           //!< The checksum used for each block, 0 = None, 1 = CRC32
+    std::optional<Header> metadata;        //!< The metadata found in the metadata blocks
+    bool metadata_read{ false };           //!< Indicating all metadata blocks are read
+    std::optional<BlockHeader> next_block; //!< A block header read ahead while looking for metadata
+    std::string pending;                   //!< Decoded GCode not yet handed out, it doesn't end on a line boundary
+    std::string raw_block_header;          //!< The raw bytes of the last read block header, used for the checksum
+};
+} // namespace GHermeneus
+
+#endif // GCODEHERMENEUS_BINARYGCODE_H
@@ -0,0 +1,149 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#ifndef GCODEHERMENEUS_DECOMPRESSOR_H
+#define GCODEHERMENEUS_DECOMPRESSOR_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace GHermeneus
+{
+/*!
+ * @brief The supported (compressed) GCode file formats, deduced from the magic bytes of the file
+ */
+enum class Compression
+{
+    None, //<! Plain text GCode
+    Gzip, //<! gzip (.gcode.gz), possibly consisting of multiple members
+    Zstd  //<! zstd (.gcode.zst), possibly consisting of multiple frames
+};
+
+/*!
+ * @brief Detect the compression of a file by looking at its magic bytes
+ * @param path the path to the file
+ * @return the detected Compression, Compression::None if the file isn't recognized as compressed
+ */
+[[nodiscard]] Compression detectCompression(const std::filesystem::path& path);
+
+constexpr size_t default_block_size{ 1 << 22 };     //!< Default minimum size of a decompressed block
+constexpr size_t default_max_blocks_in_flight{ 4 }; //!< Default maximum number of blocks waiting to be consumed
+constexpr size_t default_max_parallel_frames{ 4 };  //!< Default maximum number of zstd frames decompressed ahead
+
+/*!
+ * The Decompressor reads a (compressed) GCode file on a worker thread and hands out blocks of text. Each block ends on
+ * a line boundary, such that the blocks can be parsed independently while still yielding the same line numbering as
+ * the uncompressed file. The worker thread decompresses ahead of the consumer, but never holds more than
+ * \p max_blocks_in_flight blocks. Data is decompressed in small chunks, so a single zstd frame or gzip member is handed
+ * out over multiple blocks. Multi-frame zstd files have up to \p max_parallel_frames frames decompressed ahead in
+ * parallel, each up to \p block_size bytes. Both limits are independent of the number of cores, such that the peak
+ * memory is bounded by roughly (max_blocks_in_flight + max_parallel_frames) * block_size.
+ *
+ * Normal usage is through a Machine:
+ *
+ *      auto UM3 = MarlinMachine();
+ *      Decompressor gcode_file("big.gcode.zst");
+ *      UM3 << gcode_file;
+ *
+ * @brief Decompresses a GCode file in line aligned blocks, overlapping decompression with parsing
+ */
+class Decompressor
+{
+  public:
+    /*!
+     * @brief Opens the file and starts decompressing on a worker thread
+     * @param path the path to the (compressed) GCode file
+     * @param block_size the minimum size in bytes of a block before it is handed out (except for the last block)
+     * @param max_blocks_in_flight the maximum number of decompressed blocks waiting to be consumed
+     * @param max_parallel_frames the maximum number of zstd frames decompressed ahead in parallel, 1 decompresses the
+     * frames sequentially on the worker thread
+     */
+    explicit Decompressor(const std::filesystem::path& path, size_t block_size = default_block_size,
+                          size_t max_blocks_in_flight = default_max_blocks_in_flight,
+                          size_t max_parallel_frames = default_max_parallel_frames);
+
+    Decompressor(const Decompressor& decompressor) = delete;
+
+    Decompressor& operator=(const Decompressor& rhs) = delete;
+
+    virtual ~Decompressor();
+
+    /*!
+     * @brief Obtain the next decompressed block, waits until the worker thread has one available. Errors that occurred
+     * during decompression are rethrown here.
+     * @return a block of GCode text ending on a line boundary or std::nullopt when the whole file is consumed
+     */
+    [[nodiscard]] std::optional<std::string> next();
+
+    /*!
+     * @brief The compression of the file being read
+     * @return the detected Compression
+     */
+    [[nodiscard]] Compression compression() const
+    {
+        return format;
+    }
+
+  private:
+    /*!
+     * @brief The worker thread, dispatches to the format specific decompression and signals the end of the stream
+     */
+    void produce();
+
+    /*!
+     * @brief Read a plain text file in chunks
+     */
+    void readPlain();
+
+    /*!
+     * @brief Inflate a (multi-member) gzip file
+     */
+    void inflateGzip();
+
+    /*!
+     * @brief Decompress a (multi-frame) zstd file, with the start of the frames decompressed ahead in parallel
+     */
+    void decompressZstd();
+
+    /*!
+     * @brief Append decompressed data to the pending block and hand out each completed line aligned block
+     * @param data decompressed data
+     * @return false if the Decompressor is being destroyed and the worker should stop
+     */
+    bool emit(const std::string_view& data);
+
+    /*!
+     * @brief Push a block on the queue, waits as long as the queue is full
+     * @param block the line aligned block
+     * @return false if the Decompressor is being destroyed and the worker should stop
+     */
+    bool push(std::string&& block);
+
+    std::filesystem::path path;    //!< The path to the (compressed) GCode file
+    Compression format;            //!< The detected compression of the file
+    size_t block_size;             //!< The minimum size of a block handed out to the consumer
+    size_t max_blocks_in_flight;   //!< The maximum number of blocks in the queue
+    size_t max_parallel_frames;    //!< The maximum number of zstd frames decompressed ahead in parallel
+    std::string pending;           //!< Decompressed data not yet handed out, it doesn't end on a line boundary
+    std::deque<std::string> queue; //!< The line aligned blocks waiting to be consumed
+    std::mutex queue_mutex;        //!< Guards the queue, finished, stopped and error
+    std::condition_variable queue_not_full;  //!< Signalled when the consumer takes a block from the queue
+    std::condition_variable queue_not_empty; //!< Signalled when the worker pushes a block or is finished
+    bool finished{ false };                  //!< Indicating the worker has pushed its last block
+    bool stopped{ false };                   //!< Indicating the Decompressor is being destroyed
+    std::exception_ptr error;                //!< An error raised by the worker, rethrown by next()
+    std::thread worker;                      //!< The thread performing the decompression
+};
+} // namespace GHermeneus
+
+#endif // GCODEHERMENEUS_DECOMPRESSOR_H
@@ -0,0 +1,89 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#ifndef GCODEHERMENEUS_HEADER_H
+#define GCODEHERMENEUS_HEADER_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace GHermeneus
+{
+constexpr size_t header_max_size{ 1 << 16 }; //!< The region at the start of a file which is searched for a header
+
+/*!
+ * @brief The material and nozzle information of a single extruder train
+ */
+struct ExtruderTrain
+{
+    std::optional<double> initial_temperature;  //!< Initial temperature of the nozzle in degrees Celsius
+    std::optional<double> material_volume_used; //!< Volume of material used in mm^3
+    std::string material_guid;                  //!< GUID of the material used
+    std::optional<double> nozzle_diameter;      //!< Diameter of the nozzle in mm
+    std::string nozzle_name;                    //!< Name of the nozzle (e.q. AA 0.4)
+};
+
+/*!
+ * @brief The axis aligned bounding box of all the printed moves
+ */
+struct BoundingBox
+{
+    Eigen::Vector3d min; //!< The minimum x, y and z
+    Eigen::Vector3d max; //!< The maximum x, y and z
+};
+
+/*!
+ * The metadata which a slicer writes ahead of the GCode body, such as the Ultimaker Griffin header:
+ *
+ *      ;START_OF_HEADER
+ *      ;FLAVOR:Griffin
+ *      ;PRINT.TIME:4533
+ *      ;PRINT.SIZE.MIN.X:9
+ *      ...
+ *      ;END_OF_HEADER
+ *
+ * or the metadata blocks of a binary GCode file. Every key/value pair found is kept in \p values, the well known keys
+ * are converted to their typed members.
+ *
+ * @brief The metadata of a GCode file, which can be obtained without parsing the GCode body
+ */
+struct Header
+{
+    std::string flavor;                        //!< The GCode flavor (e.q. Griffin)
+    std::string generator_name;                //!< The name of the slicer which generated the GCode
+    std::string generator_version;             //!< The version of the slicer which generated the GCode
+    std::string target_machine;                //!< The name of the machine the GCode is generated for
+    std::optional<double> print_time;          //!< Estimated print time in seconds
+    std::vector<ExtruderTrain> extruder_trains; //!< The extruder trains used, indexed by their number
+    std::optional<BoundingBox> bounding_box;   //!< Bounding box of the print
+    std::map<std::string, std::string, std::less<>> values; //!< All the key/value pairs in the header
+};
+
+/*!
+ * @brief Parse a Griffin header from the start of the GCode
+ * @param GCode a string_view containing (at least the start of) the GCode
+ * @return the Header or std::nullopt if the GCode doesn't start with a complete Griffin header
+ */
+[[nodiscard]] std::optional<Header> parseGriffinHeader(const std::string_view& GCode);
+
+/*!
+ * Only the header region of the file is read, the GCode body isn't touched. Both Griffin headers in text files and
+ * the metadata blocks of binary GCode files are supported.
+ *
+ * @brief Read the header of a GCode file without reading the GCode body
+ * @param path the path to the GCode file
+ * @return the Header or std::nullopt if the file doesn't contain a header
+ */
+[[nodiscard]] std::optional<Header> readHeader(const std::filesystem::path& path);
+} // namespace GHermeneus
+
+#endif // GCODEHERMENEUS_HEADER_H
@@ -6,7 +6,9 @@
 #define GHERMENEUS_MACHINE_H
 
 #include <algorithm>
+#include <deque>
 #include <execution>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -22,7 +24,10 @@
 #include <range/v3/view/take.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include "BinaryGCode.h"
+#include "Decompressor.h"
 #include "GCode.h"
+#include "Header.h"
 #include "Instruction.h"
 #include "Parameters.h"
 
@@ -68,33 +73,31 @@ class Machine
     void parse(const std::string_view& GCode)
     {
         gcode = GCode;
-        extractLines(GCode); // extract the individual GCode lines
+        gcode_header = parseGriffinHeader(GCode.substr(0, std::min(GCode.size(), header_max_size)));
+        cmdlines.clear();
+        parseBlock(GCode, 0);
+    }
 
-        // Extract the Commands from each line
-        std::vector<std::optional<Instruction<SSV_T, T>>> extractedCmds(lines.size());
-        if (parallel_execution)
-        {
-            std::transform(std::execution::par, lines.begin(), lines.end(), extractedCmds.begin(), extractCmd);
-        }
-        else
-        {
-            std::transform(std::execution::seq, lines.begin(), lines.end(), extractedCmds.begin(), extractCmd);
-        }
-        extractedCmds.erase(std::remove_if(std::execution::seq, extractedCmds.begin(), extractedCmds.end(),
-                                           [](const auto& cmd) { return !cmd; }),
-                            extractedCmds.end());
-        cmdlines.resize(extractedCmds.size());
-        if (parallel_execution)
-        {
-            std::transform(std::execution::par, extractedCmds.begin(), extractedCmds.end(), cmdlines.begin(),
-                           [](const auto& cmd) { return cmd.value(); });
-            std::sort(std::execution::par, cmdlines.begin(), cmdlines.end());
-        }
-        else
-        {
-            std::transform(std::execution::seq, extractedCmds.begin(), extractedCmds.end(), cmdlines.begin(),
-                           [](const auto& cmd) { return cmd.value(); });
-        }
+    /*!
+     * The fast path for metadata queries, only the header region of the file is read and the GCode body isn't parsed.
+     * Use the operator<< to parse the body when it's needed.
+     *
+     * @brief Read the header of a GCode file without parsing the GCode
+     * @param path the path to a text or binary GCode file
+     * @return the Header or std::nullopt if the file doesn't contain a header
+     */
+    [[nodiscard]] static std::optional<Header> readHeader(const std::filesystem::path& path)
+    {
+        return GHermeneus::readHeader(path);
+    }
+
+    /*!
+     * @brief The header of the parsed GCode
+     * @return the Header or std::nullopt if the parsed GCode doesn't contain a header
+     */
+    [[nodiscard]] const std::optional<Header>& header() const
+    {
+        return gcode_header;
     }
 
     /*!
@@ -143,6 +146,45 @@ class Machine
         return machine;
     }
 
+    /*!
+     * Each block handed out by the Decompressor is parsed while the Decompressor is decompressing the next blocks.
+     * The blocks end on a line boundary, the line numbers are continued over the blocks, such that they're equal to
+     * those of the uncompressed GCode.
+     *
+     * @brief Output the (compressed) GCode file to the Machines Instruction Vector
+     * @param machine The machine of type Machine<SSV_T, T>
+     * @param file A Decompressor reading a gzip, zstd or plain text GCode file
+     * @return A machine of type Machine<SSV_T, T>
+     */
+    friend Machine<SSV_T, T>& operator<<(Machine<SSV_T, T>& machine, Decompressor& file)
+    {
+        std::string header_region;
+        machine.parseBlocks(file, [&](const std::string_view& gcode_block) {
+            if (!machine.gcode_header && header_region.size() < header_max_size)
+            {
+                header_region += gcode_block.substr(0, header_max_size - header_region.size());
+                machine.gcode_header = parseGriffinHeader(header_region);
+            }
+        });
+        return machine;
+    }
+
+    /*!
+     * The GCode blocks of the binary GCode are decoded one by one and each is parsed directly, the binary GCode is
+     * never converted to a complete text file.
+     *
+     * @brief Output the binary GCode file to the Machines Instruction Vector
+     * @param machine The machine of type Machine<SSV_T, T>
+     * @param file A BinaryGCodeReader reading a binary GCode file
+     * @return A machine of type Machine<SSV_T, T>
+     */
+    friend Machine<SSV_T, T>& operator<<(Machine<SSV_T, T>& machine, BinaryGCodeReader& file)
+    {
+        machine.parseBlocks(file, [](const std::string_view&) {});
+        machine.gcode_header = file.header();
+        return machine;
+    }
+
     /*!
      * @brief Allow for parallel execution, standard on
      * @param parallelExecution true if parallel execution is allowed, false for sequenced execution
@@ -153,17 +195,79 @@ class Machine
     }
 
   private:
+    /*!
+     * @brief parse all blocks handed out by a block source, such as a Decompressor or a BinaryGCodeReader
+     * @tparam SOURCE_T the type of the block source, next() should return the next block ending on a line boundary
+     * @tparam CALLBACK_T the type of the callback
+     * @param source the block source
+     * @param on_block callback called with each block before it is parsed
+     */
+    template <typename SOURCE_T, typename CALLBACK_T>
+    void parseBlocks(SOURCE_T& source, CALLBACK_T&& on_block)
+    {
+        raw_gcode.clear();
+        raw_blocks.clear();
+        gcode = {};
+        gcode_header.reset();
+        cmdlines.clear();
+        size_t line_offset{ 0 };
+        while (auto block = source.next())
+        {
+            // The instructions refer to the block text, a deque keeps it in place while new blocks are added
+            const std::string_view gcode_block{ raw_blocks.emplace_back(std::move(*block)) };
+            on_block(gcode_block);
+            parseBlock(gcode_block, line_offset);
+            line_offset += std::count(gcode_block.begin(), gcode_block.end(), '\n');
+        }
+    }
+
+    /*!
+     * @brief parse a block of GCode and append the instructions to the machine instruction vector
+     * @param GCode a string_view containing the GCode block, this should start at the beginning of a line
+     * @param line_offset the line number of the first line in the block
+     */
+    void parseBlock(const std::string_view& GCode, const size_t line_offset)
+    {
+        extractLines(GCode, line_offset); // extract the individual GCode lines
+
+        // Extract the Commands from each line
+        std::vector<std::optional<Instruction<SSV_T, T>>> extractedCmds(lines.size());
+        if (parallel_execution)
+        {
+            std::transform(std::execution::par, lines.begin(), lines.end(), extractedCmds.begin(), extractCmd);
+        }
+        else
+        {
+            std::transform(std::execution::seq, lines.begin(), lines.end(), extractedCmds.begin(), extractCmd);
+        }
+
+        // The extracted commands are already ordered by line number. Instructions are move constructed into the table,
+        // since assigning an Instruction doesn't copy its (const) members.
+        cmdlines.reserve(cmdlines.size() + extractedCmds.size());
+        for (auto& cmd : extractedCmds)
+        {
+            if (cmd)
+            {
+                cmdlines.emplace_back(std::move(*cmd));
+            }
+        }
+    }
+
     /*!
      * @brief extract the individual lines from the GCode
      * @param GCode a string_view containing the GCode
+     * @param line_offset the line number of the first line
      */
-    void extractLines(const std::string_view& GCode)
+    void extractLines(const std::string_view& GCode, const size_t line_offset = 0)
     {
         // TODO: keep in mind CRLF and LF
-        lines = gcode | ranges::views::split('\n') | ranges::views::transform([](auto&& line) {
+        lines = GCode | ranges::views::split('\n') | ranges::views::transform([](auto&& line) {
                     return std::string_view(&*line.begin(), ranges::distance(line));
                 })
-                | ranges::views::enumerate | ranges::to_vector;
+                | ranges::views::enumerate | ranges::views::transform([line_offset](auto&& line) {
+                      return Line(line.first + line_offset, line.second);
+                  })
+                | ranges::to_vector;
     };
 
     /*!
@@ -210,7 +314,9 @@ class Machine
     };
 
     std::string raw_gcode;   //!< The raw GCode (needed to store files and make sure the data of \p gcode stays in scope
+    std::deque<std::string> raw_blocks; //!< The decompressed GCode blocks, the instructions refer to their data
     std::string_view gcode;  //!< A string_view with the full gcode
+    std::optional<Header> gcode_header; //!< The header of the parsed GCode
     std::vector<Line> lines; //!< A vector of Lines, a Line is a pair with the line number and the string_view
     std::vector<Instruction<SSV_T, T>> cmdlines; //!< A vector of instructions converted from the lines
     bool parallel_execution;                     //!< Indicating if parsing should be done in parallel
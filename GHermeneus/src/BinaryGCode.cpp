@@ -0,0 +1,625 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#include "../include/GHermeneus/BinaryGCode.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+namespace GHermeneus
+{
+namespace
+{
+constexpr std::string_view magic{ "GCDE" };
+constexpr size_t file_header_size{ 10 };  //!< magic, version (uint32) and checksum type (uint16)
+constexpr size_t checksum_size{ 4 };      //!< Size of a CRC32 checksum
+constexpr uint16_t checksum_crc32{ 1 };   //!< Checksum type indicating each block ends with a CRC32 checksum
+constexpr uint32_t supported_version{ 1 }; //!< The binary GCode version this reader is written for
+
+/*!
+ * @brief Read a little endian unsigned integer from a byte buffer
+ * @tparam UINT_T the unsigned integer type
+ * @param data the buffer of at least sizeof(UINT_T) bytes
+ * @return the unsigned integer
+ */
+template <typename UINT_T>
+UINT_T fromLittleEndian(const char* data)
+{
+    UINT_T value{ 0 };
+    for (size_t i = 0; i < sizeof(UINT_T); ++i)
+    {
+        value |= static_cast<UINT_T>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+/*!
+ * @brief Read exactly size bytes from the file
+ * @param file the input file
+ * @param size the number of bytes to read
+ * @return the bytes read
+ */
+std::string readBytes(std::ifstream& file, size_t size)
+{
+    std::string bytes(size, '\0');
+    if (!file.read(bytes.data(), static_cast<std::streamsize>(size)))
+    {
+        throw std::runtime_error("Binary GCode file is truncated");
+    }
+    return bytes;
+}
+
+/*!
+ * @brief Parse a duration as written by slicers in binary GCode metadata (e.q. 1d 2h 3m 4s)
+ * @param duration the duration as text
+ * @return the duration in seconds or std::nullopt if it isn't a duration
+ */
+std::optional<double> toSeconds(const std::string_view& duration)
+{
+    double seconds{ 0 };
+    double number{ 0 };
+    bool has_number{ false };
+    bool has_unit{ false };
+    for (const char c : duration)
+    {
+        if (std::isdigit(static_cast<unsigned char>(c)))
+        {
+            number = number * 10 + (c - '0');
+            has_number = true;
+            continue;
+        }
+        if (!has_number)
+        {
+            continue;
+        }
+        switch (c)
+        {
+            case 'd':
+                seconds += number * 86400;
+                break;
+            case 'h':
+                seconds += number * 3600;
+                break;
+            case 'm':
+                seconds += number * 60;
+                break;
+            case 's':
+                seconds += number;
+                break;
+            default:
+                return std::nullopt;
+        }
+        number = 0;
+        has_number = false;
+        has_unit = true;
+    }
+    if (!has_unit)
+    {
+        return std::nullopt;
+    }
+    return seconds;
+}
+
+/*!
+ * @brief Split a comma separated list of per extruder values
+ * @param list the comma separated list
+ * @return the individual values
+ */
+std::vector<std::string> splitList(const std::string_view& list)
+{
+    std::vector<std::string> values;
+    size_t pos{ 0 };
+    while (pos <= list.size())
+    {
+        const auto comma = std::min(list.find(',', pos), list.size());
+        values.emplace_back(list.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+/*!
+ * Heatshrink is an LZSS variant. The bit stream is read most significant bit first, a 1 bit is followed by an 8 bit
+ * literal, a 0 bit by a back-reference of \p window_bits bits index and \p lookahead_bits bits count. A back-reference
+ * repeats count + 1 bytes starting index + 1 bytes before the end of the output, bytes before the start of the output
+ * are zero. The last byte is padded with zero bits.
+ *
+ * @brief Decompress heatshrink compressed data
+ * @param data the compressed data
+ * @param window_bits the base 2 log of the window size (11 or 12 for binary GCode)
+ * @param lookahead_bits the base 2 log of the maximum back-reference length (4 for binary GCode)
+ * @param uncompressed_size the size of the decompressed data
+ * @return the decompressed data
+ */
+std::string heatshrinkDecompress(const std::string_view& data, const size_t window_bits, const size_t lookahead_bits,
+                                 const size_t uncompressed_size)
+{
+    size_t bit_pos{ 0 };
+    const size_t bit_count{ data.size() * 8 };
+    const auto read_bits = [&](const size_t count) {
+        size_t value{ 0 };
+        for (size_t i = 0; i < count; ++i, ++bit_pos)
+        {
+            const auto byte = static_cast<unsigned char>(data[bit_pos / 8]);
+            value = (value << 1) | ((byte >> (7 - bit_pos % 8)) & 1);
+        }
+        return value;
+    };
+
+    std::string decompressed;
+    decompressed.reserve(uncompressed_size);
+    while (decompressed.size() < uncompressed_size && bit_pos < bit_count)
+    {
+        const bool literal = read_bits(1) == 1;
+        if (literal)
+        {
+            if (bit_count - bit_pos < 8)
+            {
+                break;
+            }
+            decompressed.push_back(static_cast<char>(read_bits(8)));
+            continue;
+        }
+        if (bit_count - bit_pos < window_bits + lookahead_bits)
+        {
+            break; // Padding
+        }
+        const auto offset = read_bits(window_bits) + 1;
+        const auto count = std::min(read_bits(lookahead_bits) + 1, uncompressed_size - decompressed.size());
+        for (size_t i = 0; i < count; ++i) // Byte by byte, a back-reference can overlap the bytes it produces
+        {
+            decompressed.push_back(offset > decompressed.size() ? '\0' : decompressed[decompressed.size() - offset]);
+        }
+    }
+    if (decompressed.size() != uncompressed_size)
+    {
+        throw std::runtime_error("Unable to decompress heatshrink binary GCode block");
+    }
+    return decompressed;
+}
+
+/*!
+ * MeatPack packs the most common GCode characters in 4 bits, two characters per byte with the first character in the
+ * low nibble. A nibble of 0b1111 signals the character is sent as a full byte after the packed byte. The byte sequence
+ * 0xFF 0xFF is followed by a command byte which toggles the packing and the omission of spaces.
+ *
+ * @brief Decodes MeatPack encoded GCode
+ */
+class MeatPackDecoder
+{
+  public:
+    /*!
+     * @brief Decode the MeatPack encoded data
+     * @param data MeatPack encoded GCode
+     * @return the decoded GCode text
+     */
+    std::string operator()(const std::string_view& data)
+    {
+        std::string text;
+        text.reserve(data.size() * 2);
+        for (const char byte : data)
+        {
+            const auto c = static_cast<unsigned char>(byte);
+            if (c == command_byte)
+            {
+                if (command_count > 0)
+                {
+                    command_is_next = true;
+                    command_count = 0;
+                }
+                else
+                {
+                    ++command_count;
+                }
+                continue;
+            }
+            if (command_is_next)
+            {
+                handleCommand(c);
+                command_is_next = false;
+                continue;
+            }
+            if (command_count > 0)
+            {
+                handleByte(command_byte, text);
+                command_count = 0;
+            }
+            handleByte(c, text);
+        }
+        return text;
+    }
+
+  private:
+    static constexpr unsigned char command_byte{ 0xFF };
+    static constexpr unsigned char full_width{ 0b1111 };
+    static constexpr std::array<char, 15> lookup{ '0', '1', '2', '3', '4', '5', '6', '7',
+                                                  '8', '9', '.', ' ', '\n', 'G', 'X' };
+
+    void handleCommand(const unsigned char command)
+    {
+        switch (command)
+        {
+            case 251: // Enable packing
+                packing = true;
+                break;
+            case 250: // Disable packing
+                packing = false;
+                break;
+            case 249: // Reset all
+                packing = false;
+                no_spaces = false;
+                break;
+            case 247: // Enable no spaces
+                no_spaces = true;
+                break;
+            case 246: // Disable no spaces
+                no_spaces = false;
+                break;
+            default: // Query config, nothing to decode
+                break;
+        }
+    }
+
+    void handleByte(const unsigned char c, std::string& text)
+    {
+        if (!packing)
+        {
+            output(static_cast<char>(c), text);
+            return;
+        }
+        if (full_char_count > 0)
+        {
+            output(static_cast<char>(c), text);
+            if (char_buffer)
+            {
+                output(*char_buffer, text);
+                char_buffer.reset();
+            }
+            --full_char_count;
+            return;
+        }
+
+        const unsigned char first = c & 0x0F;
+        const unsigned char second = (c >> 4) & 0x0F;
+        if (first == full_width)
+        {
+            ++full_char_count;
+            if (second == full_width)
+            {
+                ++full_char_count;
+            }
+            else
+            {
+                char_buffer = unpack(second);
+            }
+            return;
+        }
+        const char first_char = unpack(first);
+        output(first_char, text);
+        if (first_char == '\n') // The second nibble is padding
+        {
+            return;
+        }
+        if (second == full_width)
+        {
+            ++full_char_count;
+        }
+        else
+        {
+            output(unpack(second), text);
+        }
+    }
+
+    [[nodiscard]] char unpack(const unsigned char nibble) const
+    {
+        if (no_spaces && nibble == 0b1011)
+        {
+            return 'E';
+        }
+        return lookup[nibble];
+    }
+
+    /*!
+     * @brief Whether the character is a parameter of a G command, a space is put back in front of these
+     */
+    [[nodiscard]] static bool isGLineParameter(const char c)
+    {
+        constexpr std::string_view parameters{ "XYZEFIJRPWHCA" };
+        return parameters.find(c) != std::string_view::npos;
+    }
+
+    /*!
+     * Like the reference (libbgcode) decoder, the spaces omitted by the encoder are put back in front of the parameters
+     * of G commands only; other commands keep their spaces when encoded. Repeated line endings are collapsed.
+     *
+     * @brief Append a decoded character
+     */
+    void output(const char c, std::string& text)
+    {
+        if (c == '\n')
+        {
+            if (text.empty() || text.back() != '\n')
+            {
+                text.push_back(c);
+            }
+            line_length = 0;
+            g_line = false;
+            in_comment = false;
+            return;
+        }
+
+        if (line_length == 1 && text.back() == 'G' && std::isdigit(static_cast<unsigned char>(c)))
+        {
+            g_line = true;
+        }
+        else if (c == ';')
+        {
+            in_comment = true;
+        }
+        if (g_line && !in_comment && isGLineParameter(c) && text.back() != ' ')
+        {
+            text.push_back(' ');
+        }
+        text.push_back(c);
+        ++line_length;
+    }
+
+    bool packing{ false };
+    bool no_spaces{ false };
+    bool command_is_next{ false };
+    size_t command_count{ 0 };
+    size_t full_char_count{ 0 };
+    std::optional<char> char_buffer;
+    size_t line_length{ 0 }; //!< Number of characters decoded on the current line
+    bool g_line{ false };     //!< Indicating the current line starts with a G command
+    bool in_comment{ false }; //!< Indicating the rest of the current line is a comment
+};
+} // namespace
+
+bool isBinaryGCode(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::array<char, magic.size()> bytes{};
+    file.read(bytes.data(), bytes.size());
+    return file.gcount() == static_cast<std::streamsize>(magic.size())
+           && std::string_view(bytes.data(), bytes.size()) == magic;
+}
+
+BinaryGCodeReader::BinaryGCodeReader(const std::filesystem::path& path) : file(path, std::ios::binary)
+{
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + path.string());
+    }
+    file_size = std::filesystem::file_size(path);
+    const auto file_header = readBytes(file, file_header_size);
+    if (std::string_view(file_header).substr(0, magic.size()) != magic)
+    {
+        throw std::runtime_error(path.string() + " is not a binary GCode file");
+    }
+    const auto version = fromLittleEndian<uint32_t>(file_header.data() + 4);
+    if (version != supported_version)
+    {
+        throw std::runtime_error("Unsupported binary GCode version " + std::to_string(version));
+    }
+    checksum_type = fromLittleEndian<uint16_t>(file_header.data() + 8);
+}
+
+const std::optional<Header>& BinaryGCodeReader::header()
+{
+    // The metadata blocks precede the GCode blocks, stop reading at the first GCode block
+    while (!metadata_read)
+    {
+        next_block = readBlockHeader();
+        if (!next_block || next_block->type == BlockType::GCode)
+        {
+            metadata_read = true;
+        }
+        else if (next_block->type == BlockType::Thumbnail)
+        {
+            skipBlock(*next_block);
+        }
+        else
+        {
+            if (!metadata)
+            {
+                metadata.emplace();
+            }
+            addMetadata(next_block->type, readBlock(*next_block));
+        }
+    }
+    return metadata;
+}
+
+std::optional<std::string> BinaryGCodeReader::next()
+{
+    static_cast<void>(header()); // Make sure the file is positioned at the first GCode block
+    while (next_block)
+    {
+        const auto block_header = *next_block;
+        if (block_header.type != BlockType::GCode)
+        {
+            skipBlock(block_header);
+            next_block = readBlockHeader();
+            continue;
+        }
+
+        pending += readBlock(block_header);
+        next_block = readBlockHeader();
+        const auto last_eol = pending.rfind('\n');
+        if (last_eol == std::string::npos)
+        {
+            continue;
+        }
+        std::string rest{ pending.substr(last_eol + 1) };
+        pending.resize(last_eol + 1);
+        return std::exchange(pending, std::move(rest));
+    }
+    if (!pending.empty())
+    {
+        return std::exchange(pending, std::string{});
+    }
+    return std::nullopt;
+}
+
+std::optional<BinaryGCodeReader::BlockHeader> BinaryGCodeReader::readBlockHeader()
+{
+    if (file.peek() == std::ifstream::traits_type::eof())
+    {
+        return std::nullopt;
+    }
+    raw_block_header = readBytes(file, 8);
+    BlockHeader block_header{ static_cast<BlockType>(fromLittleEndian<uint16_t>(raw_block_header.data())),
+                              static_cast<BlockCompression>(fromLittleEndian<uint16_t>(raw_block_header.data() + 2)),
+                              fromLittleEndian<uint32_t>(raw_block_header.data() + 4), 0 };
+    if (block_header.compression == BlockCompression::None)
+    {
+        block_header.compressed_size = block_header.uncompressed_size;
+    }
+    else
+    {
+        raw_block_header += readBytes(file, 4);
+        block_header.compressed_size = fromLittleEndian<uint32_t>(raw_block_header.data() + 8);
+    }
+    return block_header;
+}
+
+std::string BinaryGCodeReader::readBlock(const BlockHeader& block_header)
+{
+    const auto parameters = readBytes(file, block_header.type == BlockType::Thumbnail ? 6 : 2);
+    auto data = readBytes(file, block_header.compressed_size);
+    if (checksum_type == checksum_crc32)
+    {
+        const auto checksum = readBytes(file, checksum_size);
+        auto crc = crc32(0L, Z_NULL, 0);
+        for (const std::string* bytes : std::array<const std::string*, 3>{ &raw_block_header, &parameters, &data })
+        {
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(bytes->data()), static_cast<uInt>(bytes->size()));
+        }
+        if (crc != fromLittleEndian<uint32_t>(checksum.data()))
+        {
+            throw std::runtime_error("Binary GCode block checksum mismatch");
+        }
+    }
+
+    std::string decompressed;
+    switch (block_header.compression)
+    {
+        case BlockCompression::None:
+            decompressed = std::move(data);
+            break;
+        case BlockCompression::Deflate:
+        {
+            decompressed.resize(block_header.uncompressed_size);
+            auto size = static_cast<uLongf>(decompressed.size());
+            if (uncompress(reinterpret_cast<Bytef*>(decompressed.data()), &size,
+                           reinterpret_cast<const Bytef*>(data.data()), static_cast<uLong>(data.size()))
+                    != Z_OK
+                || size != decompressed.size())
+            {
+                throw std::runtime_error("Unable to inflate binary GCode block");
+            }
+            break;
+        }
+        case BlockCompression::Heatshrink11_4:
+            decompressed = heatshrinkDecompress(data, 11, 4, block_header.uncompressed_size);
+            break;
+        case BlockCompression::Heatshrink12_4:
+            decompressed = heatshrinkDecompress(data, 12, 4, block_header.uncompressed_size);
+            break;
+        default:
+            throw std::runtime_error("Unsupported binary GCode block compression "
+                                     + std::to_string(static_cast<uint16_t>(block_header.compression)));
+    }
+
+    const auto encoding = static_cast<BlockEncoding>(fromLittleEndian<uint16_t>(parameters.data()));
+    if (block_header.type == BlockType::GCode && encoding != BlockEncoding::None)
+    {
+        return MeatPackDecoder()(decompressed);
+    }
+    return decompressed;
+}
+
+void BinaryGCodeReader::skipBlock(const BlockHeader& block_header)
+{
+    const size_t parameters_size = block_header.type == BlockType::Thumbnail ? 6 : 2;
+    const size_t size = parameters_size + block_header.compressed_size
+                        + (checksum_type == checksum_crc32 ? checksum_size : 0);
+    // Seeking past the end of the file succeeds, so the truncation is detected by comparing against the file size
+    const auto position = file.tellg();
+    if (position < 0 || static_cast<uintmax_t>(position) + size > file_size
+        || !file.seekg(static_cast<std::streamoff>(size), std::ios::cur))
+    {
+        throw std::runtime_error("Binary GCode file is truncated");
+    }
+}
+
+void BinaryGCodeReader::addMetadata(const BlockType type, const std::string_view& ini)
+{
+    size_t pos{ 0 };
+    while (pos < ini.size())
+    {
+        const auto eol = std::min(ini.find('\n', pos), ini.size());
+        const auto line = ini.substr(pos, eol - pos);
+        pos = eol + 1;
+        const auto separator = line.find('=');
+        if (separator == std::string_view::npos)
+        {
+            continue;
+        }
+        const auto key = line.substr(0, separator);
+        const auto value = line.substr(separator + 1);
+        metadata->values.emplace(key, value);
+
+        if (type == BlockType::FileMetadata && key == "Producer") // e.q. PrusaSlicer 2.6.0
+        {
+            const auto separator = value.rfind(' ');
+            metadata->generator_name = value.substr(0, separator);
+            metadata->generator_version = separator == std::string_view::npos ? "" : value.substr(separator + 1);
+        }
+        else if (type == BlockType::PrinterMetadata && key == "printer_model")
+        {
+            metadata->target_machine = value;
+        }
+        else if (key == "estimated printing time (normal mode)")
+        {
+            metadata->print_time = toSeconds(value);
+        }
+        else if (key == "nozzle_diameter" || key == "filament used [cm3]")
+        {
+            const auto values = splitList(value);
+            if (metadata->extruder_trains.size() < values.size())
+            {
+                metadata->extruder_trains.resize(values.size());
+            }
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                try
+                {
+                    const double number = std::stod(values[i]);
+                    auto& train = metadata->extruder_trains[i];
+                    if (key == "nozzle_diameter")
+                    {
+                        train.nozzle_diameter = number;
+                    }
+                    else
+                    {
+                        train.material_volume_used = number * 1000; // cm^3 to mm^3
+                    }
+                }
+                catch (const std::exception&)
+                {
+                    continue;
+                }
+            }
+        }
+    }
+}
+} // namespace GHermeneus
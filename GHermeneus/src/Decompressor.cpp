@@ -0,0 +1,367 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#include "../include/GHermeneus/Decompressor.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+#include <zstd.h>
+
+namespace GHermeneus
+{
+namespace
+{
+constexpr size_t read_chunk_size{ 1 << 16 }; //!< Size of the chunks read from disk and inflated
+
+/*!
+ * @brief A zstd frame being decompressed, possibly with part of its output decoded ahead
+ */
+struct ZstdFrame
+{
+    explicit ZstdFrame(const std::string_view& frame)
+        : dctx{ ZSTD_createDCtx(), &ZSTD_freeDCtx }, input{ frame.data(), frame.size(), 0 }
+    {
+        if (!dctx)
+        {
+            throw std::runtime_error("Unable to create a zstd decompression context");
+        }
+    }
+
+    [[nodiscard]] bool done() const
+    {
+        return remaining == 0;
+    }
+
+    /*!
+     * @brief Decompress the next piece of the frame
+     * @param out_chunk the buffer receiving the decompressed data
+     * @return the number of bytes written to \p out_chunk
+     */
+    size_t decompress(std::vector<char>& out_chunk)
+    {
+        ZSTD_outBuffer output{ out_chunk.data(), out_chunk.size(), 0 };
+        remaining = ZSTD_decompressStream(dctx.get(), &output, &input);
+        if (ZSTD_isError(remaining))
+        {
+            throw std::runtime_error(std::string("zstd decompression failed: ") + ZSTD_getErrorName(remaining));
+        }
+        if (input.pos == input.size && output.pos == 0 && remaining != 0)
+        {
+            throw std::runtime_error("zstd frame is truncated");
+        }
+        return output.pos;
+    }
+
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx; //!< The decompression context of this frame
+    ZSTD_inBuffer input;                                        //!< The compressed frame and the position in it
+    size_t remaining{ 1 }; //!< Non zero as long as the frame isn't completely decompressed
+    std::string ahead;     //!< Output decompressed ahead, before the frame is handed to the worker
+};
+
+/*!
+ * @brief Decompress the start of a zstd frame ahead, in parallel with the other frames
+ * @param frame a string_view containing exactly one (possibly skippable) frame
+ * @param max_ahead the maximum number of bytes to decompress ahead, this caps the memory used per frame
+ * @return the partially decompressed frame
+ */
+ZstdFrame decompressZstdAhead(const std::string_view& frame, const size_t max_ahead)
+{
+    ZstdFrame zstd_frame{ frame };
+    std::vector<char> out_chunk(read_chunk_size);
+    while (!zstd_frame.done() && zstd_frame.ahead.size() < max_ahead)
+    {
+        const auto size = zstd_frame.decompress(out_chunk);
+        zstd_frame.ahead.append(out_chunk.data(), size);
+    }
+    return zstd_frame;
+}
+} // namespace
+
+Compression detectCompression(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + path.string());
+    }
+    std::array<unsigned char, 4> magic{};
+    file.read(reinterpret_cast<char*>(magic.data()), magic.size());
+    const auto read = file.gcount();
+    if (read >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+    {
+        return Compression::Gzip;
+    }
+    if (read == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+    {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+Decompressor::Decompressor(const std::filesystem::path& path, size_t block_size, size_t max_blocks_in_flight,
+                           size_t max_parallel_frames)
+    : path{ path }
+    , format{ detectCompression(path) }
+    , block_size{ std::max<size_t>(block_size, 1) }
+    , max_blocks_in_flight{ std::max<size_t>(max_blocks_in_flight, 1) }
+    , max_parallel_frames{ std::max<size_t>(max_parallel_frames, 1) }
+{
+    worker = std::thread(&Decompressor::produce, this);
+}
+
+Decompressor::~Decompressor()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopped = true;
+    }
+    queue_not_full.notify_all();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+std::optional<std::string> Decompressor::next()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_not_empty.wait(lock, [this] { return !queue.empty() || finished; });
+    if (!queue.empty())
+    {
+        std::string block{ std::move(queue.front()) };
+        queue.pop_front();
+        lock.unlock();
+        queue_not_full.notify_one();
+        return block;
+    }
+    if (error)
+    {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+    return std::nullopt;
+}
+
+void Decompressor::produce()
+{
+    try
+    {
+        switch (format)
+        {
+            case Compression::Gzip:
+                inflateGzip();
+                break;
+            case Compression::Zstd:
+                decompressZstd();
+                break;
+            default:
+                readPlain();
+                break;
+        }
+        if (!pending.empty())
+        {
+            push(std::move(pending));
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        finished = true;
+    }
+    queue_not_empty.notify_all();
+}
+
+void Decompressor::readPlain()
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> chunk(read_chunk_size);
+    while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0)
+    {
+        if (!emit(std::string_view(chunk.data(), file.gcount())))
+        {
+            return;
+        }
+    }
+}
+
+void Decompressor::inflateGzip()
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> in_chunk(read_chunk_size);
+    std::vector<char> out_chunk(4 * read_chunk_size);
+
+    z_stream stream{};
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) // 15 + 32: maximum window with automatic gzip/zlib header detection
+    {
+        throw std::runtime_error("Unable to initialize zlib inflate");
+    }
+    std::unique_ptr<z_stream, decltype(&inflateEnd)> guard{ &stream, &inflateEnd };
+
+    int ret{ Z_OK };
+    while (file.read(in_chunk.data(), in_chunk.size()) || file.gcount() > 0)
+    {
+        stream.next_in = reinterpret_cast<Bytef*>(in_chunk.data());
+        stream.avail_in = static_cast<uInt>(file.gcount());
+        while (stream.avail_in > 0)
+        {
+            if (ret == Z_STREAM_END)
+            {
+                // Trailing zero padding (e.g. from tar or block devices) after the last member is ignored
+                const auto* const in_begin = stream.next_in;
+                if (std::all_of(in_begin, in_begin + stream.avail_in, [](const Bytef byte) { return byte == 0; }))
+                {
+                    stream.avail_in = 0;
+                    break;
+                }
+                inflateReset(&stream); // A concatenated gzip member follows the previous one
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(out_chunk.data());
+            stream.avail_out = static_cast<uInt>(out_chunk.size());
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+            {
+                throw std::runtime_error("gzip decompression failed: " + std::string(stream.msg ? stream.msg : ""));
+            }
+            if (!emit(std::string_view(out_chunk.data(), out_chunk.size() - stream.avail_out)))
+            {
+                return;
+            }
+        }
+    }
+
+    // Flush the output remaining in the inflate window once all the input is consumed
+    while (ret == Z_OK)
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(out_chunk.data());
+        stream.avail_out = static_cast<uInt>(out_chunk.size());
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret == Z_BUF_ERROR && stream.avail_out == out_chunk.size())
+        {
+            throw std::runtime_error("gzip stream is truncated");
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END)
+        {
+            throw std::runtime_error("gzip decompression failed: " + std::string(stream.msg ? stream.msg : ""));
+        }
+        if (!emit(std::string_view(out_chunk.data(), out_chunk.size() - stream.avail_out)))
+        {
+            return;
+        }
+    }
+}
+
+void Decompressor::decompressZstd()
+{
+    // Frame boundaries can only be found in the compressed data, which is a fraction of the decompressed size
+    std::ifstream file(path, std::ios::binary);
+    const std::string compressed{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    std::vector<std::string_view> frames;
+    for (std::string_view remaining{ compressed }; !remaining.empty();)
+    {
+        const auto frame_size = ZSTD_findFrameCompressedSize(remaining.data(), remaining.size());
+        if (ZSTD_isError(frame_size))
+        {
+            throw std::runtime_error(std::string("Invalid zstd frame: ") + ZSTD_getErrorName(frame_size));
+        }
+        frames.emplace_back(remaining.substr(0, frame_size));
+        remaining.remove_prefix(frame_size);
+    }
+
+    // Hand out the output decompressed ahead, then stream the rest of the frame in chunks
+    std::vector<char> out_chunk(read_chunk_size);
+    const auto stream_frame = [&](ZstdFrame& zstd_frame) {
+        if (!emit(std::exchange(zstd_frame.ahead, std::string{})))
+        {
+            return false;
+        }
+        while (!zstd_frame.done())
+        {
+            const auto size = zstd_frame.decompress(out_chunk);
+            if (!emit(std::string_view(out_chunk.data(), size)))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (frames.size() == 1 || max_parallel_frames == 1)
+    {
+        for (const auto& frame : frames)
+        {
+            ZstdFrame zstd_frame{ frame };
+            if (!stream_frame(zstd_frame))
+            {
+                return;
+            }
+        }
+        return;
+    }
+
+    // Keep at most max_parallel_frames frames decompressing ahead in parallel, each up to block_size bytes
+    std::deque<std::future<ZstdFrame>> in_flight;
+    auto next_frame = frames.begin();
+    while (next_frame != frames.end() || !in_flight.empty())
+    {
+        while (next_frame != frames.end() && in_flight.size() < max_parallel_frames)
+        {
+            in_flight.emplace_back(std::async(std::launch::async, decompressZstdAhead, *next_frame++, block_size));
+        }
+        auto zstd_frame = in_flight.front().get();
+        in_flight.pop_front();
+        if (!stream_frame(zstd_frame))
+        {
+            return;
+        }
+    }
+}
+
+bool Decompressor::emit(const std::string_view& data)
+{
+    pending.append(data);
+
+    // Cut the pending data in blocks of at least block_size, each ending on a line boundary
+    size_t start{ 0 };
+    while (pending.size() - start >= block_size)
+    {
+        const auto eol = pending.find('\n', start + block_size - 1);
+        if (eol == std::string::npos)
+        {
+            break; // The last line isn't complete yet, keep on reading until it ends
+        }
+        if (!push(pending.substr(start, eol + 1 - start)))
+        {
+            return false;
+        }
+        start = eol + 1;
+    }
+    pending.erase(0, start);
+    return true;
+}
+
+bool Decompressor::push(std::string&& block)
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_not_full.wait(lock, [this] { return queue.size() < max_blocks_in_flight || stopped; });
+    if (stopped)
+    {
+        return false;
+    }
+    queue.emplace_back(std::move(block));
+    lock.unlock();
+    queue_not_empty.notify_one();
+    return true;
+}
+} // namespace GHermeneus
@@ -0,0 +1,202 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#include "../include/GHermeneus/Header.h"
+
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+
+#include "../include/GHermeneus/BinaryGCode.h"
+
+namespace GHermeneus
+{
+namespace
+{
+constexpr std::string_view start_of_header{ ";START_OF_HEADER" };
+constexpr std::string_view end_of_header{ ";END_OF_HEADER" };
+constexpr size_t max_extruder_trains{ 16 }; //!< Extruder trains with a higher index are ignored
+
+/*!
+ * @brief Convert a header value to a double
+ * @param value the value as text
+ * @return the value or std::nullopt if it isn't a number
+ */
+std::optional<double> toDouble(const std::string& value)
+{
+    try
+    {
+        return std::stod(value);
+    }
+    catch (const std::exception&)
+    {
+        return std::nullopt;
+    }
+}
+
+/*!
+ * @brief Convert a well known Griffin key/value pair to the typed members of the header
+ * @param header the Header to update
+ * @param key the Griffin key (e.q. PRINT.TIME)
+ * @param value the value as text
+ */
+void addGriffinValue(Header& header, const std::string_view& key, const std::string& value)
+{
+    if (key == "FLAVOR")
+    {
+        header.flavor = value;
+    }
+    else if (key == "GENERATOR.NAME")
+    {
+        header.generator_name = value;
+    }
+    else if (key == "GENERATOR.VERSION")
+    {
+        header.generator_version = value;
+    }
+    else if (key == "TARGET_MACHINE.NAME")
+    {
+        header.target_machine = value;
+    }
+    else if (key == "PRINT.TIME")
+    {
+        header.print_time = toDouble(value);
+    }
+    else if (key.starts_with("PRINT.SIZE.") && key.size() == 16) // PRINT.SIZE.MIN.X
+    {
+        const auto extreme = key.substr(11, 3);
+        const auto axis = key.back() - 'X';
+        const auto coordinate = toDouble(value);
+        if ((extreme != "MIN" && extreme != "MAX") || axis < 0 || axis > 2 || !coordinate)
+        {
+            return;
+        }
+        if (!header.bounding_box)
+        {
+            header.bounding_box = BoundingBox{ Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero() };
+        }
+        auto& corner = extreme == "MIN" ? header.bounding_box->min : header.bounding_box->max;
+        corner[axis] = *coordinate;
+    }
+    else if (key.starts_with("EXTRUDER_TRAIN."))
+    {
+        const auto index_end = key.find('.', 15);
+        if (index_end == std::string_view::npos)
+        {
+            return;
+        }
+        const auto index = key.substr(15, index_end - 15);
+        size_t train_no{ 0 };
+        const auto [index_last, error] = std::from_chars(index.data(), index.data() + index.size(), train_no);
+        if (error != std::errc() || index_last != index.data() + index.size() || train_no >= max_extruder_trains)
+        {
+            return;
+        }
+        if (header.extruder_trains.size() <= train_no)
+        {
+            header.extruder_trains.resize(train_no + 1);
+        }
+        auto& train = header.extruder_trains[train_no];
+        const auto property = key.substr(index_end + 1);
+        if (property == "INITIAL_TEMPERATURE")
+        {
+            train.initial_temperature = toDouble(value);
+        }
+        else if (property == "MATERIAL.VOLUME_USED")
+        {
+            train.material_volume_used = toDouble(value);
+        }
+        else if (property == "MATERIAL.GUID")
+        {
+            train.material_guid = value;
+        }
+        else if (property == "NOZZLE.DIAMETER")
+        {
+            train.nozzle_diameter = toDouble(value);
+        }
+        else if (property == "NOZZLE.NAME")
+        {
+            train.nozzle_name = value;
+        }
+    }
+}
+} // namespace
+
+std::optional<Header> parseGriffinHeader(const std::string_view& GCode)
+{
+    if (!GCode.starts_with(start_of_header))
+    {
+        return std::nullopt;
+    }
+
+    Header header;
+    size_t pos{ 0 };
+    while (pos < GCode.size())
+    {
+        const auto eol = std::min(GCode.find('\n', pos), GCode.size());
+        auto line = GCode.substr(pos, eol - pos);
+        pos = eol + 1;
+        if (line.ends_with('\r'))
+        {
+            line.remove_suffix(1);
+        }
+        if (line == end_of_header)
+        {
+            return header;
+        }
+
+        // A header line is formatted as ;KEY:VALUE
+        const auto separator = line.find(':');
+        if (!line.starts_with(';') || separator == std::string_view::npos)
+        {
+            continue;
+        }
+        const auto key = line.substr(1, separator - 1);
+        std::string value{ line.substr(separator + 1) };
+        addGriffinValue(header, key, value);
+        header.values.emplace(key, std::move(value));
+    }
+    return std::nullopt; // The header isn't complete
+}
+
+std::optional<Header> readHeader(const std::filesystem::path& path)
+{
+    if (isBinaryGCode(path))
+    {
+        return BinaryGCodeReader(path).header();
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + path.string());
+    }
+
+    // Only read the start of the file, until the end of the header is found
+    constexpr size_t chunk_size{ 1 << 12 };
+    std::string header_region;
+    while (header_region.size() < header_max_size)
+    {
+        const auto size = header_region.size();
+        header_region.resize(size + chunk_size);
+        file.read(header_region.data() + size, chunk_size);
+        header_region.resize(size + file.gcount());
+
+        if (!header_region.starts_with(start_of_header.substr(0, std::min(header_region.size(), start_of_header.size()))))
+        {
+            return std::nullopt;
+        }
+        if (header_region.find(end_of_header, size > end_of_header.size() ? size - end_of_header.size() : 0)
+            != std::string::npos)
+        {
+            return parseGriffinHeader(header_region);
+        }
+        if (file.gcount() == 0)
+        {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace GHermeneus
@@ -0,0 +1,67 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <string>
+
+#include "GHermeneus/GHermeneus.h"
+
+static const std::string big_file{ "../resources/big.gcode" };
+static const std::string big_binary_file{ "../resources/big.bgcode" };
+
+using namespace GHermeneus::Dialects::Marlin;
+
+static void bmBigFileHeader(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(MarlinMachine::readHeader(big_file));
+    }
+}
+
+BENCHMARK(bmBigFileHeader);
+
+static void bmBigFileHeaderFullParse(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        std::ifstream gcode_file(big_file);
+        UM3 << gcode_file;
+        benchmark::DoNotOptimize(UM3.header());
+    }
+}
+
+BENCHMARK(bmBigFileHeaderFullParse);
+
+static void bmBigBinaryFileHeader(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(MarlinMachine::readHeader(big_binary_file));
+    }
+}
+
+BENCHMARK(bmBigBinaryFileHeader);
+
+static void bmBigBinaryFileHeaderFullParse(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        GHermeneus::BinaryGCodeReader gcode_file(big_binary_file);
+        UM3 << gcode_file;
+        benchmark::DoNotOptimize(UM3.header());
+    }
+}
+
+BENCHMARK(bmBigBinaryFileHeaderFullParse);
+
+BENCHMARK_MAIN();
@@ -4,13 +4,23 @@
 
 #include <benchmark/benchmark.h>
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string_view>
+#include <vector>
+
+#include <zlib.h>
+#include <zstd.h>
 
 #include "GHermeneus/GHermeneus.h"
 
 static const std::string simple_file{ "../resources/simple.gcode" };
 static const std::string big_file{ "../resources/big.gcode" };
+static const std::string big_gzip_file{ "../resources/big.gcode.gz" };
+static const std::string big_zstd_file{ "../resources/big.gcode.zst" };
 
 size_t getNol(const std::string& filename)
 {
@@ -24,6 +34,53 @@ size_t getNol(const std::string& filename)
     return nol;
 }
 
+static const std::filesystem::path decompressed_file{ std::filesystem::temp_directory_path()
+                                                       / "bm_machine_decompressed.gcode" };
+
+/*!
+ * @brief Decompress a gzip file to disk with zlib, the way compressed GCode was handled before a Machine could read it
+ * @param filename the compressed GCode file
+ */
+void decompressGzipToDisk(const std::string& filename)
+{
+    std::ofstream output(decompressed_file, std::ios::binary);
+    gzFile file = gzopen(filename.c_str(), "rb");
+    std::vector<char> chunk(1 << 16);
+    int size{ 0 };
+    while ((size = gzread(file, chunk.data(), static_cast<unsigned>(chunk.size()))) > 0)
+    {
+        output.write(chunk.data(), size);
+    }
+    gzclose(file);
+}
+
+/*!
+ * @brief Decompress a zstd file to disk with zstd, the way compressed GCode was handled before a Machine could read it
+ * @param filename the compressed GCode file
+ */
+void decompressZstdToDisk(const std::string& filename)
+{
+    std::ifstream input(filename, std::ios::binary);
+    std::ofstream output(decompressed_file, std::ios::binary);
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx{ ZSTD_createDCtx(), &ZSTD_freeDCtx };
+    std::vector<char> in_chunk(ZSTD_DStreamInSize());
+    std::vector<char> out_chunk(ZSTD_DStreamOutSize());
+    while (input.read(in_chunk.data(), in_chunk.size()) || input.gcount() > 0)
+    {
+        ZSTD_inBuffer in_buffer{ in_chunk.data(), static_cast<size_t>(input.gcount()), 0 };
+        while (in_buffer.pos < in_buffer.size)
+        {
+            ZSTD_outBuffer out_buffer{ out_chunk.data(), out_chunk.size(), 0 };
+            const auto ret = ZSTD_decompressStream(dctx.get(), &out_buffer, &in_buffer);
+            if (ZSTD_isError(ret))
+            {
+                throw std::runtime_error(ZSTD_getErrorName(ret));
+            }
+            output.write(out_chunk.data(), out_buffer.pos);
+        }
+    }
+}
+
 using namespace GHermeneus::Dialects::Marlin;
 
 static void bmSimpleFileParallel(benchmark::State& state)
@@ -88,4 +145,74 @@ static void bmBigFile(benchmark::State& state)
 
 BENCHMARK(bmBigFile);
 
+static void bmBigGzipFile(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        GHermeneus::Decompressor gcode_file(big_gzip_file);
+        UM3 << gcode_file;
+    }
+    state.SetItemsProcessed(getNol(big_file));
+}
+
+BENCHMARK(bmBigGzipFile);
+
+static void bmBigGzipFileDecompressThenParse(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        decompressGzipToDisk(big_gzip_file);
+        std::ifstream gcode_file(decompressed_file);
+        UM3 << gcode_file;
+        state.PauseTiming();
+        gcode_file.close();
+        std::filesystem::remove(decompressed_file);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(getNol(big_file));
+}
+
+BENCHMARK(bmBigGzipFileDecompressThenParse);
+
+static void bmBigZstdFile(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        GHermeneus::Decompressor gcode_file(big_zstd_file);
+        UM3 << gcode_file;
+    }
+    state.SetItemsProcessed(getNol(big_file));
+}
+
+BENCHMARK(bmBigZstdFile);
+
+static void bmBigZstdFileDecompressThenParse(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto UM3 = MarlinMachine();
+        state.ResumeTiming();
+        decompressZstdToDisk(big_zstd_file);
+        std::ifstream gcode_file(decompressed_file);
+        UM3 << gcode_file;
+        state.PauseTiming();
+        gcode_file.close();
+        std::filesystem::remove(decompressed_file);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(getNol(big_file));
+}
+
+BENCHMARK(bmBigZstdFileDecompressThenParse);
+
 BENCHMARK_MAIN();
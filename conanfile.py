@@ -19,6 +19,8 @@ class GHermeneusConan(ConanFile):
         self.requires.add("eigen/3.3.7@conan/stable")
         self.requires.add("range-v3/0.10.0@ericniebler/stable")
         self.requires.add("tbb/2020.1")
+        self.requires.add("zlib/1.2.11")
+        self.requires.add("zstd/1.4.5")
         if self.options.build_tests:
             self.requires.add("gtest/1.10.0")
         if self.options.build_benchmarks:
@@ -0,0 +1,373 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+#include "GHermeneus/GHermeneus.h"
+
+namespace
+{
+std::filesystem::path writeFile(const std::string& filename, const std::string& content)
+{
+    const auto path = std::filesystem::temp_directory_path() / filename;
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+    return path;
+}
+
+template <typename UINT_T>
+void appendLittleEndian(std::string& bytes, UINT_T value)
+{
+    for (size_t i = 0; i < sizeof(UINT_T); ++i)
+    {
+        bytes.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+/*!
+ * A greedy heatshrink encoder with a lookahead of 4 bits, a 1 bit is followed by an 8 bit literal and a 0 bit by a
+ * back-reference of window_bits index and 4 bits count, most significant bit first.
+ *
+ * @brief Heatshrink compress the data
+ */
+std::string heatshrink(const std::string& data, size_t window_bits)
+{
+    constexpr size_t lookahead_bits{ 4 };
+    const size_t window_size{ size_t{ 1 } << window_bits };
+    const size_t max_length{ size_t{ 1 } << lookahead_bits };
+
+    std::string compressed;
+    size_t bit_count{ 0 };
+    const auto write_bits = [&](size_t value, size_t count) {
+        for (size_t i = count; i-- > 0; ++bit_count)
+        {
+            if (bit_count % 8 == 0)
+            {
+                compressed.push_back('\0');
+            }
+            compressed.back() = static_cast<char>(compressed.back() | (((value >> i) & 1) << (7 - bit_count % 8)));
+        }
+    };
+
+    for (size_t pos = 0; pos < data.size();)
+    {
+        size_t best_offset{ 0 };
+        size_t best_length{ 0 };
+        for (size_t offset = 1; offset <= std::min(pos, window_size); ++offset)
+        {
+            size_t length{ 0 };
+            while (length < max_length && pos + length < data.size()
+                   && data[pos + length] == data[pos + length - offset])
+            {
+                ++length;
+            }
+            if (length > best_length)
+            {
+                best_offset = offset;
+                best_length = length;
+            }
+        }
+        if (best_length < 3)
+        {
+            write_bits(1, 1);
+            write_bits(static_cast<unsigned char>(data[pos]), 8);
+            ++pos;
+            continue;
+        }
+        write_bits(0, 1);
+        write_bits(best_offset - 1, window_bits);
+        write_bits(best_length - 1, lookahead_bits);
+        pos += best_length;
+    }
+    return compressed;
+}
+
+/*!
+ * @brief Create a binary GCode block
+ * @param checksum append a CRC32 checksum to the block
+ */
+std::string binaryBlock(GHermeneus::BlockType type, const std::string& data, bool checksum = false,
+                        GHermeneus::BlockCompression compression = GHermeneus::BlockCompression::None,
+                        GHermeneus::BlockEncoding encoding = GHermeneus::BlockEncoding::None)
+{
+    std::string payload{ data };
+    if (compression == GHermeneus::BlockCompression::Deflate)
+    {
+        auto size = compressBound(static_cast<uLong>(data.size()));
+        payload.resize(size);
+        compress(reinterpret_cast<Bytef*>(payload.data()), &size, reinterpret_cast<const Bytef*>(data.data()),
+                 static_cast<uLong>(data.size()));
+        payload.resize(size);
+    }
+    else if (compression == GHermeneus::BlockCompression::Heatshrink11_4)
+    {
+        payload = heatshrink(data, 11);
+    }
+    else if (compression == GHermeneus::BlockCompression::Heatshrink12_4)
+    {
+        payload = heatshrink(data, 12);
+    }
+
+    std::string block;
+    appendLittleEndian<uint16_t>(block, static_cast<uint16_t>(type));
+    appendLittleEndian<uint16_t>(block, static_cast<uint16_t>(compression));
+    appendLittleEndian<uint32_t>(block, static_cast<uint32_t>(data.size()));
+    if (compression != GHermeneus::BlockCompression::None)
+    {
+        appendLittleEndian<uint32_t>(block, static_cast<uint32_t>(payload.size()));
+    }
+    appendLittleEndian<uint16_t>(block, static_cast<uint16_t>(encoding));
+    block += payload;
+    if (checksum)
+    {
+        appendLittleEndian<uint32_t>(
+            block, static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(block.data()),
+                                               static_cast<uInt>(block.size()))));
+    }
+    return block;
+}
+
+/*!
+ * @brief Create a binary GCode file with metadata blocks followed by the given GCode blocks
+ * @param checksum whether the blocks end with a CRC32 checksum
+ */
+std::string binaryGCode(const std::string& gcode_blocks, bool checksum)
+{
+    std::string bgcode{ "GCDE" };
+    appendLittleEndian<uint32_t>(bgcode, 1);        // Version
+    appendLittleEndian<uint16_t>(bgcode, checksum); // 0 = None, 1 = CRC32
+    bgcode += binaryBlock(GHermeneus::BlockType::FileMetadata, "Producer=PrusaSlicer 2.6.0\n", checksum);
+    bgcode += binaryBlock(GHermeneus::BlockType::PrinterMetadata,
+                          "printer_model=MK4\n"
+                          "nozzle_diameter=0.4\n"
+                          "estimated printing time (normal mode)=1h 2m 3s\n",
+                          checksum, GHermeneus::BlockCompression::Deflate);
+    bgcode += binaryBlock(GHermeneus::BlockType::PrintMetadata,
+                          "filament used [mm]=1234.56\n"
+                          "filament used [cm3]=2.97, 0.5\n",
+                          checksum);
+    return bgcode + gcode_blocks;
+}
+
+std::string binaryGCode(const std::string& body)
+{
+    return binaryGCode(binaryBlock(GHermeneus::BlockType::GCode, body), false);
+}
+
+/*!
+ * MeatPack encode the GCode with packing and no spaces enabled. Like the reference encoder, the spaces are only
+ * omitted from G lines, the other lines keep their spaces as full width characters.
+ *
+ * @brief MeatPack encode the GCode
+ */
+std::string meatPack(const std::string& gcode)
+{
+    constexpr std::string_view packed{ "0123456789.E\nGX" }; // Code 11 is E instead of a space in no spaces mode
+    std::string text;
+    std::istringstream lines{ gcode };
+    for (std::string line; std::getline(lines, line);)
+    {
+        if (line.starts_with('G'))
+        {
+            line.erase(std::remove(line.begin(), line.end(), ' '), line.end());
+        }
+        text += line + "\n";
+    }
+
+    std::string encoded{ "\xFF\xFF\xFB\xFF\xFF\xF7" }; // Enable packing, enable no spaces
+    for (size_t i = 0; i < text.size();)
+    {
+        const char first = text[i];
+        if (first == '\n')
+        {
+            encoded.push_back(static_cast<char>(packed.find('\n')));
+            ++i;
+            continue;
+        }
+        const char second = i + 1 < text.size() ? text[i + 1] : '\n';
+        const auto first_code = std::min(packed.find(first), std::string_view::size_type{ 0b1111 });
+        const auto second_code = std::min(packed.find(second), std::string_view::size_type{ 0b1111 });
+        encoded.push_back(static_cast<char>(first_code | (second_code << 4)));
+        if (first_code == 0b1111)
+        {
+            encoded.push_back(first);
+        }
+        if (second_code == 0b1111)
+        {
+            encoded.push_back(second);
+        }
+        i += 2;
+    }
+    return encoded;
+}
+
+/*!
+ * @brief Read all GCode blocks from the binary GCode file
+ */
+std::string decodeBinaryGCode(const std::filesystem::path& path)
+{
+    GHermeneus::BinaryGCodeReader gcode_file(path);
+    std::string gcode;
+    while (auto block = gcode_file.next())
+    {
+        gcode += *block;
+    }
+    return gcode;
+}
+} // namespace
+
+TEST(BinaryGCodeTestSuite, ReadHeader)
+{
+    const auto path = writeFile("ghermeneus_header.bgcode", binaryGCode("G1 X10 Y20 E0.5\n"));
+    ASSERT_TRUE(GHermeneus::isBinaryGCode(path));
+    const auto header = GHermeneus::readHeader(path);
+    ASSERT_TRUE(header);
+    EXPECT_TRUE(header->flavor.empty());
+    EXPECT_EQ(header->generator_name, "PrusaSlicer");
+    EXPECT_EQ(header->generator_version, "2.6.0");
+    EXPECT_EQ(header->target_machine, "MK4");
+    EXPECT_DOUBLE_EQ(*header->print_time, 3723);
+    ASSERT_EQ(header->extruder_trains.size(), 2);
+    EXPECT_DOUBLE_EQ(*header->extruder_trains[0].nozzle_diameter, 0.4);
+    EXPECT_DOUBLE_EQ(*header->extruder_trains[0].material_volume_used, 2970);
+    EXPECT_DOUBLE_EQ(*header->extruder_trains[1].material_volume_used, 500);
+    EXPECT_FALSE(header->extruder_trains[1].nozzle_diameter);
+    EXPECT_EQ(header->values.at("filament used [mm]"), "1234.56");
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, ParseGCodeBlocks)
+{
+    const std::string body{ "T0\n"
+                            "G92 E0\n"
+                            "G0 F15000 X100 Y75.75 Z2\n"
+                            "G1 F1500 E-6.5\n"
+                            "G1 X10 Y20 E0.5\n" };
+    using namespace GHermeneus::Dialects::Marlin;
+    auto expected_UM3 = MarlinMachine();
+    expected_UM3 << std::string_view{ body };
+    std::stringstream expected;
+    expected << expected_UM3;
+
+    // The GCode is spread over two blocks, the fourth line starts in the first block and ends in the second block
+    const auto split = body.find("F1500 E");
+    const auto gcode_blocks = binaryBlock(GHermeneus::BlockType::GCode, body.substr(0, split))
+                              + binaryBlock(GHermeneus::BlockType::GCode, body.substr(split));
+    const auto path = writeFile("ghermeneus_parse.bgcode", binaryGCode(gcode_blocks, false));
+    GHermeneus::BinaryGCodeReader gcode_file(path);
+    auto UM3 = MarlinMachine();
+    UM3 << gcode_file;
+    std::stringstream result;
+    result << UM3;
+
+    EXPECT_EQ(result.str(), expected.str());
+    EXPECT_NE(result.str().find("line: 3 command: G1 Parameters -> F = 1500.000000 E = -6.500000"), std::string::npos);
+    EXPECT_NE(result.str().find("line: 4 command: G1 Parameters -> X = 10.000000 Y = 20.000000 E = 0.500000"),
+              std::string::npos);
+    ASSERT_TRUE(UM3.header());
+    EXPECT_EQ(UM3.header()->target_machine, "MK4");
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, DeflateWithChecksum)
+{
+    const std::string body{ "G0 F15000 X100 Y75.75 Z2\n"
+                            "G1 F1500 E-6.5\n" };
+    const auto gcode_block = binaryBlock(GHermeneus::BlockType::GCode, body, true,
+                                         GHermeneus::BlockCompression::Deflate);
+    const auto path = writeFile("ghermeneus_deflate.bgcode", binaryGCode(gcode_block, true));
+    const auto header = GHermeneus::readHeader(path);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->target_machine, "MK4");
+    EXPECT_EQ(decodeBinaryGCode(path), body);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, ChecksumMismatchThrows)
+{
+    auto gcode_block = binaryBlock(GHermeneus::BlockType::GCode, "G1 X10 Y20 E0.5\n", true);
+    gcode_block.back() ^= 0x01; // Corrupt the checksum
+    const auto path = writeFile("ghermeneus_checksum.bgcode", binaryGCode(gcode_block, true));
+    EXPECT_THROW(decodeBinaryGCode(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, TruncatedThumbnailThrows)
+{
+    std::string bgcode{ "GCDE" };
+    appendLittleEndian<uint32_t>(bgcode, 1); // Version
+    appendLittleEndian<uint16_t>(bgcode, 0); // No checksum
+    appendLittleEndian<uint16_t>(bgcode, static_cast<uint16_t>(GHermeneus::BlockType::Thumbnail));
+    appendLittleEndian<uint16_t>(bgcode, static_cast<uint16_t>(GHermeneus::BlockCompression::None));
+    appendLittleEndian<uint32_t>(bgcode, 1000000); // The thumbnail claims 1 MB, but only 3 bytes follow
+    bgcode += "PNG";
+    const auto path = writeFile("ghermeneus_truncated.bgcode", bgcode);
+    EXPECT_THROW(static_cast<void>(GHermeneus::readHeader(path)), std::runtime_error);
+    EXPECT_THROW(decodeBinaryGCode(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, MeatPack)
+{
+    const std::string body{ "G1 X10.5 Y20 E0.3 F1500\n"
+                            "M862.3 P\"MK4\"\n"
+                            "M117 PrusaSlicer\n"
+                            "G0 X1 Y2\n" };
+    const auto gcode_block = binaryBlock(GHermeneus::BlockType::GCode, meatPack(body), false,
+                                         GHermeneus::BlockCompression::None, GHermeneus::BlockEncoding::MeatPack);
+    const auto path = writeFile("ghermeneus_meatpack.bgcode", binaryGCode(gcode_block, false));
+    EXPECT_EQ(decodeBinaryGCode(path), body); // Spaces are only put back in the G lines
+    std::filesystem::remove(path);
+}
+
+/*!
+ * @brief GCode with repeated lines and comments, the lines repeat further back than the smallest heatshrink window
+ */
+std::string heatshrinkGCode()
+{
+    std::string gcode{ ";LAYER_CHANGE\n"
+                       ";Z:0.2\n"
+                       "M204 P800\n"
+                       "G1 Z.2 F720\n" };
+    for (size_t i = 0; i < 200; ++i)
+    {
+        gcode += "G1 X" + std::to_string(100 + i % 50) + ".5 Y" + std::to_string(20 + i % 7) + " E0.0312\n";
+        if (i % 40 == 0)
+        {
+            gcode += ";TYPE:Perimeter\n;WIDTH:0.45\n";
+        }
+    }
+    return gcode;
+}
+
+TEST(BinaryGCodeTestSuite, Heatshrink11MeatPack)
+{
+    const auto body = heatshrinkGCode();
+    const auto gcode_block = binaryBlock(GHermeneus::BlockType::GCode, meatPack(body), true,
+                                         GHermeneus::BlockCompression::Heatshrink11_4,
+                                         GHermeneus::BlockEncoding::MeatPackComments);
+    const auto path = writeFile("ghermeneus_heatshrink11.bgcode", binaryGCode(gcode_block, true));
+    EXPECT_EQ(decodeBinaryGCode(path), body);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryGCodeTestSuite, Heatshrink12MeatPack)
+{
+    const auto body = heatshrinkGCode();
+    const auto gcode_block = binaryBlock(GHermeneus::BlockType::GCode, meatPack(body), true,
+                                         GHermeneus::BlockCompression::Heatshrink12_4,
+                                         GHermeneus::BlockEncoding::MeatPackComments);
+    const auto path = writeFile("ghermeneus_heatshrink12.bgcode", binaryGCode(gcode_block, true));
+    EXPECT_EQ(decodeBinaryGCode(path), body);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,241 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include "GHermeneus/GHermeneus.h"
+
+namespace
+{
+const std::string GCode{ ";START_OF_HEADER\n"
+                         ";FLAVOR:Griffin\n"
+                         ";END_OF_HEADER\n"
+                         "T0\n"
+                         "M82 ;absolute extrusion mode\n"
+                         "G92 E0\n"
+                         ";LAYER:0\n"
+                         "G0 F15000 X100 Y75.75 Z2\n"
+                         "G1 F1500 E-6.5\n"
+                         "G1 F600 Z0.27\n"
+                         "G1 F1500 E0\n"
+                         "G1 F1200 X110 Y100 E0.0500\n"
+                         "G1 Y110.33 E0.0655\n" };
+
+/*!
+ * @brief A larger GCode, such that it spans multiple blocks, gzip members and zstd frames
+ */
+std::string bigGCode()
+{
+    std::string gcode{ GCode };
+    for (size_t i = 0; i < 500; ++i)
+    {
+        gcode += "G1 X" + std::to_string(i % 200) + " Y" + std::to_string(i % 150) + ".5 E" + std::to_string(i) + "\n";
+        if (i % 50 == 0)
+        {
+            gcode += ";LAYER:" + std::to_string(i / 50) + "\n";
+        }
+    }
+    return gcode;
+}
+
+/*!
+ * @brief Split the content in parts of about part_size bytes, the parts don't end on a line boundary
+ */
+std::vector<std::string> splitParts(const std::string& content, size_t part_size)
+{
+    std::vector<std::string> parts;
+    for (size_t pos = 0; pos < content.size(); pos += part_size)
+    {
+        parts.emplace_back(content.substr(pos, part_size));
+    }
+    return parts;
+}
+
+/*!
+ * @brief Write the content as a gzip file, with a gzip member for each part
+ */
+std::filesystem::path writeGzip(const std::string& filename, const std::string& content, size_t part_size = 1 << 20)
+{
+    const auto path = std::filesystem::temp_directory_path() / filename;
+    std::filesystem::remove(path);
+    for (const auto& part : splitParts(content, part_size))
+    {
+        gzFile file = gzopen(path.c_str(), "ab"); // Appending to a gzip file starts a new member
+        gzwrite(file, part.data(), static_cast<unsigned>(part.size()));
+        gzclose(file);
+    }
+    return path;
+}
+
+/*!
+ * @brief Write the content as a zstd file, with a zstd frame for each part
+ */
+std::filesystem::path writeZstd(const std::string& filename, const std::string& content, size_t part_size = 1 << 20)
+{
+    const auto path = std::filesystem::temp_directory_path() / filename;
+    std::ofstream file(path, std::ios::binary);
+    for (const auto& part : splitParts(content, part_size))
+    {
+        std::string frame(ZSTD_compressBound(part.size()), '\0');
+        frame.resize(ZSTD_compress(frame.data(), frame.size(), part.data(), part.size(), 3));
+        file << frame;
+    }
+    return path;
+}
+
+/*!
+ * @brief Truncate a file to half its size
+ */
+void truncateFile(const std::filesystem::path& path)
+{
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+}
+
+/*!
+ * @brief The CSV output of a machine which parsed the GCode text
+ */
+std::string parseText(const std::string& gcode)
+{
+    using namespace GHermeneus::Dialects::Marlin;
+    auto UM3 = MarlinMachine();
+    UM3 << std::string_view{ gcode };
+    std::stringstream output;
+    output << UM3;
+    return output.str();
+}
+
+/*!
+ * @brief The CSV output of a machine which parsed the (compressed) GCode file through a Decompressor
+ */
+std::string parseFile(const std::filesystem::path& path, size_t block_size)
+{
+    using namespace GHermeneus::Dialects::Marlin;
+    GHermeneus::Decompressor gcode_file(path, block_size, 2);
+    auto UM3 = MarlinMachine();
+    UM3 << gcode_file;
+    std::stringstream output;
+    output << UM3;
+    return output.str();
+}
+
+/*!
+ * @brief Read all blocks from the Decompressor
+ */
+std::string decompress(const std::filesystem::path& path, size_t block_size)
+{
+    GHermeneus::Decompressor gcode_file(path, block_size, 2);
+    std::string decompressed;
+    while (auto block = gcode_file.next())
+    {
+        decompressed += *block;
+    }
+    return decompressed;
+}
+} // namespace
+
+TEST(DecompressorTestSuite, DetectCompression)
+{
+    const auto gzip_path = writeGzip("ghermeneus_detect.gcode.gz", GCode);
+    EXPECT_EQ(GHermeneus::detectCompression(gzip_path), GHermeneus::Compression::Gzip);
+    std::filesystem::remove(gzip_path);
+
+    const auto zstd_path = writeZstd("ghermeneus_detect.gcode.zst", GCode);
+    EXPECT_EQ(GHermeneus::detectCompression(zstd_path), GHermeneus::Compression::Zstd);
+    std::filesystem::remove(zstd_path);
+}
+
+TEST(DecompressorTestSuite, BlocksEndOnLineBoundary)
+{
+    const auto path = writeGzip("ghermeneus_blocks.gcode.gz", GCode);
+    GHermeneus::Decompressor gcode_file(path, 1, 1);
+    std::string decompressed;
+    while (auto block = gcode_file.next())
+    {
+        EXPECT_EQ(block->back(), '\n');
+        decompressed += *block;
+    }
+    EXPECT_EQ(decompressed, GCode);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, MultiMemberGzip)
+{
+    const auto gcode = bigGCode();
+    const auto path = writeGzip("ghermeneus_multi_member.gcode.gz", gcode, 1000);
+    EXPECT_EQ(decompress(path, 256), gcode);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, TrailingZeroPaddingGzip)
+{
+    const auto gcode = bigGCode();
+    const auto path = writeGzip("ghermeneus_zero_padding.gcode.gz", gcode, 1000);
+    {
+        // The padding spans more than one chunk read from disk
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        const std::string padding(100000, '\0');
+        file.write(padding.data(), padding.size());
+    }
+    EXPECT_EQ(decompress(path, 256), gcode);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, MultiFrameZstd)
+{
+    const auto gcode = bigGCode();
+    const auto path = writeZstd("ghermeneus_multi_frame.gcode.zst", gcode, 1000);
+    EXPECT_EQ(decompress(path, 256), gcode);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, ParseCompressedGCodeFile)
+{
+    const auto path = writeGzip("ghermeneus_parse.gcode.gz", GCode);
+    const auto result = parseFile(path, 1);
+    EXPECT_EQ(result, parseText(GCode));
+    EXPECT_NE(result.find("line: 12 command: G1 Parameters -> Y = 110.330000 E = 0.065500"), std::string::npos);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, ParseMultiFrameZstdGCodeFile)
+{
+    const auto gcode = bigGCode();
+    const auto path = writeZstd("ghermeneus_parse.gcode.zst", gcode, 1000);
+    const auto result = parseFile(path, 64);
+    EXPECT_EQ(result, parseText(gcode));
+
+    // The line numbers are continued over the blocks and frames, the last line is far beyond the first block
+    const auto last_line_no = std::count(gcode.begin(), gcode.end(), '\n') - 1;
+    const auto last_line = gcode.substr(gcode.rfind('\n', gcode.size() - 2) + 1);
+    EXPECT_EQ(last_line, "G1 X99 Y49.5 E499\n");
+    EXPECT_NE(result.find("line: " + std::to_string(last_line_no) + " command: G1 Parameters -> X = 99.000000"),
+              std::string::npos);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, TruncatedGzipThrows)
+{
+    const auto path = writeGzip("ghermeneus_truncated.gcode.gz", bigGCode());
+    truncateFile(path);
+    EXPECT_THROW(decompress(path, 256), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(DecompressorTestSuite, TruncatedZstdThrows)
+{
+    const auto path = writeZstd("ghermeneus_truncated.gcode.zst", bigGCode());
+    truncateFile(path);
+    EXPECT_THROW(decompress(path, 256), std::runtime_error);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,96 @@
+//
+// Created by Jelle Spijker on 10/19/20.
+//
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "GHermeneus/GHermeneus.h"
+
+namespace
+{
+const std::string GCode{ ";START_OF_HEADER\n"
+                         ";HEADER_VERSION:0.1\n"
+                         ";FLAVOR:Griffin\n"
+                         ";GENERATOR.NAME:Cura_SteamEngine\n"
+                         ";GENERATOR.VERSION:4.7.1\n"
+                         ";TARGET_MACHINE.NAME:Ultimaker 3\n"
+                         ";EXTRUDER_TRAIN.0.INITIAL_TEMPERATURE:200\n"
+                         ";EXTRUDER_TRAIN.0.MATERIAL.VOLUME_USED:1391\n"
+                         ";EXTRUDER_TRAIN.0.NOZZLE.DIAMETER:0.4\n"
+                         ";EXTRUDER_TRAIN.0.NOZZLE.NAME:AA 0.4\n"
+                         ";PRINT.TIME:4533\n"
+                         ";PRINT.SIZE.MIN.X:9\n"
+                         ";PRINT.SIZE.MIN.Y:6\n"
+                         ";PRINT.SIZE.MIN.Z:0.27\n"
+                         ";PRINT.SIZE.MAX.X:173.325\n"
+                         ";PRINT.SIZE.MAX.Y:164.325\n"
+                         ";PRINT.SIZE.MAX.Z:21.87\n"
+                         ";END_OF_HEADER\n"
+                         "T0\n"
+                         "G92 E0\n"
+                         "G0 F15000 X100 Y75.75 Z2\n"
+                         "G1 F1500 E-6.5\n" };
+
+std::filesystem::path writeFile(const std::string& filename, const std::string& content)
+{
+    const auto path = std::filesystem::temp_directory_path() / filename;
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+    return path;
+}
+} // namespace
+
+TEST(HeaderTestSuite, ParseGriffinHeader)
+{
+    const auto header = GHermeneus::parseGriffinHeader(GCode);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->flavor, "Griffin");
+    EXPECT_EQ(header->generator_name, "Cura_SteamEngine");
+    EXPECT_EQ(header->target_machine, "Ultimaker 3");
+    EXPECT_DOUBLE_EQ(*header->print_time, 4533);
+    ASSERT_EQ(header->extruder_trains.size(), 1);
+    EXPECT_DOUBLE_EQ(*header->extruder_trains[0].material_volume_used, 1391);
+    EXPECT_EQ(header->extruder_trains[0].nozzle_name, "AA 0.4");
+    ASSERT_TRUE(header->bounding_box);
+    EXPECT_DOUBLE_EQ(header->bounding_box->min.z(), 0.27);
+    EXPECT_DOUBLE_EQ(header->bounding_box->max.x(), 173.325);
+    EXPECT_EQ(header->values.at("HEADER_VERSION"), "0.1");
+
+    EXPECT_FALSE(GHermeneus::parseGriffinHeader("G0 X100\n"));
+    EXPECT_FALSE(GHermeneus::parseGriffinHeader(";START_OF_HEADER\n;FLAVOR:Griffin\n"));
+}
+
+TEST(HeaderTestSuite, InvalidExtruderTrainIndexIsIgnored)
+{
+    const auto header = GHermeneus::parseGriffinHeader(";START_OF_HEADER\n"
+                                                       ";EXTRUDER_TRAIN.1e17.NOZZLE.NAME:AA 0.4\n"
+                                                       ";EXTRUDER_TRAIN.18446744073709551616.NOZZLE.NAME:AA 0.4\n"
+                                                       ";EXTRUDER_TRAIN.1000000.NOZZLE.NAME:AA 0.4\n"
+                                                       ";EXTRUDER_TRAIN.-1.NOZZLE.NAME:AA 0.4\n"
+                                                       ";EXTRUDER_TRAIN.1.NOZZLE.NAME:BB 0.4\n"
+                                                       ";END_OF_HEADER\n");
+    ASSERT_TRUE(header);
+    ASSERT_EQ(header->extruder_trains.size(), 2);
+    EXPECT_TRUE(header->extruder_trains[0].nozzle_name.empty());
+    EXPECT_EQ(header->extruder_trains[1].nozzle_name, "BB 0.4");
+    EXPECT_EQ(header->values.at("EXTRUDER_TRAIN.1e17.NOZZLE.NAME"), "AA 0.4"); // The raw value is still available
+}
+
+TEST(HeaderTestSuite, ReadHeaderWithoutParsing)
+{
+    const auto path = writeFile("ghermeneus_header.gcode", GCode);
+    using namespace GHermeneus::Dialects::Marlin;
+    const auto header = MarlinMachine::readHeader(path);
+    ASSERT_TRUE(header);
+    EXPECT_DOUBLE_EQ(*header->print_time, 4533);
+    std::filesystem::remove(path);
+
+    auto UM3 = MarlinMachine();
+    UM3 << std::string_view{ GCode };
+    ASSERT_TRUE(UM3.header());
+    EXPECT_EQ(UM3.header()->generator_version, "4.7.1");
+}